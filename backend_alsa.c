@@ -0,0 +1,315 @@
+/****************************************************************************
+ * Slampler : Slug Sampler
+ *
+ * ALSA backends
+ * "alsa" writes a FRAMES-long buffer with snd_pcm_writei(),
+ * "mmap" renders straight into the device ring buffer
+ * Both drain the capture stream, if any, in the same loop
+ * When the engine is idle, both top the buffer up with silence and sleep
+ * on the switches for half a buffer, instead of waking up every FRAMES
+ *
+ * Copyright (C) Jean Zundel <jzu@free.fr> 2010
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ ****************************************************************************/
+
+#define ALSA_PCM_NEW_HW_PARAMS_API
+
+#include <alsa/asoundlib.h>
+#include "slampler.h"
+
+snd_pcm_t *handle_play,
+          *handle_capt;
+
+short *playbuf,                      // Mixed audio
+      *captbuf,                      // Read from capture stream
+      *silence;                      // A whole buffer of it
+
+snd_pcm_uframes_t buffer_size,
+                  period_size;
+int   idle_ms;                       // Sleep when idle
+
+int   alsa_open (char *device, int capt);
+int   mmap_open (char *device, int capt);
+void  alsa_run ();
+void  mmap_run ();
+
+struct backend alsa_backend = { "alsa", alsa_open, alsa_run };
+struct backend mmap_backend = { "mmap", mmap_open, mmap_run };
+
+
+/****************************************************************************
+ * pcm_open()
+ *
+ * PCM playback setup - stereo : some soundcards don't do mono
+ * Optional capture on the same device, same format, non-blocking so that
+ * the playback stream alone paces the loop. Both streams are linked,
+ * i.e. they start together and run off the same clock.
+ * *device  ALSA device name
+ * capt     Open the capture stream too
+ * access   RW or MMAP interleaved
+ ****************************************************************************/
+
+int pcm_open (char *device, int capt, snd_pcm_access_t access) {
+
+  int rc;
+
+  rc = snd_pcm_open (&handle_play, device, SND_PCM_STREAM_PLAYBACK, 0);
+  if (rc < 0) {
+    ERROR (stderr,
+           "play - unable to open pcm device: %s\n", snd_strerror (rc));
+    return -1;
+  }
+  if ((rc = snd_pcm_set_params (handle_play,
+                                SND_PCM_FORMAT_S16_LE,
+                                access,
+                                2,                               // Stereo
+                                RATE,
+                                1,                               // Resample
+                                80000)) < 0) {                   // 0.08 sec
+    ERROR (stderr,
+           "Playback open error: %s\n", snd_strerror (rc));
+    return -1;
+  }
+
+  snd_pcm_get_params (handle_play, &buffer_size, &period_size);
+  silence = (short *) calloc (buffer_size, 4);
+  idle_ms = buffer_size * 1000 / RATE / 2;
+  if (idle_ms < 1)
+    idle_ms = 1;
+  DEBUG ("buffer %d frames, period %d, idle wakeup %d ms\n",
+         (int) buffer_size, (int) period_size, idle_ms);
+
+  handle_capt = NULL;
+  if (! capt)
+    return 0;
+
+  rc = snd_pcm_open (&handle_capt, device,
+                     SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK);
+  if (rc < 0) {
+    ERROR (stderr,
+           "capt - unable to open pcm device: %s\n", snd_strerror (rc));
+    handle_capt = NULL;
+  }
+  else
+  if ((rc = snd_pcm_set_params (handle_capt,
+                                SND_PCM_FORMAT_S16_LE,
+                                SND_PCM_ACCESS_RW_INTERLEAVED,
+                                2,
+                                RATE,
+                                1,
+                                80000)) < 0) {
+    ERROR (stderr,
+           "Capture open error: %s\n", snd_strerror (rc));
+    snd_pcm_close (handle_capt);
+    handle_capt = NULL;
+  }
+  else
+  if ((rc = snd_pcm_link (handle_capt, handle_play)) < 0)
+    ERROR (stderr,
+           "Capture link error: %s\n", snd_strerror (rc));
+
+  captbuf = (short *) malloc (frames * 4 * 4);           // Up to 4 periods
+  capt_in = (handle_capt != NULL);
+  return 0;
+}
+
+
+/****************************************************************************
+ * pcm_capture()
+ *
+ * Drains whatever the capture stream has and hands it to the engine
+ ****************************************************************************/
+
+void pcm_capture () {
+
+  int rc;
+
+  if (! handle_capt)
+    return;
+  do {
+    rc = snd_pcm_readi (handle_capt,
+                        captbuf,
+                        frames * 4);
+    if (rc == -EPIPE) {
+      ERROR (stderr,
+             "readi - overrun occurred\n");
+      snd_pcm_prepare (handle_capt);
+    } else if (rc > 0)
+      capture (captbuf, rc);
+  } while (rc == frames * 4);                    // More where it came from
+}
+
+
+/****************************************************************************
+ * alsa_idle()
+ *
+ * Tops the buffer up with silence in one write, then sleeps
+ ****************************************************************************/
+
+void alsa_idle () {
+
+  snd_pcm_sframes_t avail;
+  int rc;
+
+  avail = snd_pcm_avail_update (handle_play);
+  if (avail == -EPIPE) {
+    ERROR (stderr,
+           "idle - underrun occurred\n");
+    snd_pcm_prepare (handle_play);
+    avail = buffer_size;
+  }
+  if (avail > (snd_pcm_sframes_t) buffer_size)
+    avail = buffer_size;
+  if (avail > 0) {
+    rc = snd_pcm_writei (handle_play,
+                         silence,
+                         avail);
+    if (rc < 0)
+      ERROR (stderr,
+             "error from write: %s\n", snd_strerror (rc));
+  }
+  pcm_capture ();
+  engine_wait (idle_ms);
+}
+
+
+/****************************************************************************
+ * alsa_open()
+ ****************************************************************************/
+
+int alsa_open (char *device, int capt) {
+
+  playbuf = (short *) malloc (frames * 4);
+  return pcm_open (device, capt, SND_PCM_ACCESS_RW_INTERLEAVED);
+}
+
+
+/****************************************************************************
+ * alsa_run()
+ *
+ * Processing loop, paced by snd_pcm_writei()
+ ****************************************************************************/
+
+void alsa_run () {
+
+  int rc;
+
+  while (1) {
+
+    if (engine_idle ()) {
+      alsa_idle ();
+      continue;
+    }
+
+    render (playbuf, frames);
+
+    /* Write playback buffer content to device */
+
+    rc = snd_pcm_writei (handle_play,
+                         playbuf,
+                         frames);
+    if (rc == -EPIPE) {
+      ERROR (stderr,
+             "writei - underrun occurred\n");
+      snd_pcm_prepare (handle_play);
+      snd_pcm_writei (handle_play,
+                      playbuf,
+                      frames);
+    } else if (rc < 0) {
+      ERROR (stderr,
+             "error from write: %s\n", snd_strerror (rc));
+    }  else if (rc != frames) {
+      ERROR (stderr,
+             "short write, write %d frames\n", rc);
+    }
+
+    pcm_capture ();
+  }
+}
+
+
+/****************************************************************************
+ * mmap_open()
+ ****************************************************************************/
+
+int mmap_open (char *device, int capt) {
+
+  return pcm_open (device, capt, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+}
+
+
+/****************************************************************************
+ * mmap_run()
+ *
+ * Processing loop, paced by snd_pcm_wait(), or by engine_wait() when idle
+ * The engine mixes directly into the device buffer, no intermediate copy
+ ****************************************************************************/
+
+void mmap_run () {
+
+  const snd_pcm_channel_area_t *areas;
+  snd_pcm_uframes_t offset,
+                    size;
+  snd_pcm_sframes_t avail;
+  short *out;
+  int rc,
+      idle;
+
+  while (1) {
+
+    idle = engine_idle ();
+
+    avail = snd_pcm_avail_update (handle_play);
+    if (avail < 0) {
+      ERROR (stderr,
+             "mmap - underrun occurred\n");
+      snd_pcm_prepare (handle_play);
+      continue;
+    }
+    if (avail < frames) {
+      if (snd_pcm_state (handle_play) == SND_PCM_STATE_PREPARED)
+        snd_pcm_start (handle_play);                     // Buffer full, go
+      else
+      if (idle)
+        engine_wait (idle_ms);
+      else
+        snd_pcm_wait (handle_play, 1000);
+      pcm_capture ();
+      continue;
+    }
+
+    size = avail;
+    if ((rc = snd_pcm_mmap_begin (handle_play, &areas, &offset, &size)) < 0) {
+      ERROR (stderr,
+             "mmap_begin error: %s\n", snd_strerror (rc));
+      snd_pcm_prepare (handle_play);
+      continue;
+    }
+    out = (short *) areas [0].addr + areas [0].first / 16 + offset * 2;
+    if (idle)
+      memset (out, 0, size * 4);
+    else
+      render (out, size);
+    rc = snd_pcm_mmap_commit (handle_play, offset, size);
+    if (rc < 0) {
+      ERROR (stderr,
+             "mmap_commit error: %s\n", snd_strerror (rc));
+      snd_pcm_prepare (handle_play);
+    } else if (rc != (int) size) {
+      ERROR (stderr,
+             "short commit, %d frames\n", rc);
+    }
+
+    pcm_capture ();
+  }
+}
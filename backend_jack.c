@@ -0,0 +1,209 @@
+/****************************************************************************
+ * Slampler : Slug Sampler
+ *
+ * JACK backend
+ * Runs as a JACK client, rendering from the process callback
+ * Build with "make JACK=1"; try it with a dummy server:
+ *
+ *  jackd -d dummy -r 44100 -p 256 &
+ *
+ * The engine runs in JACK's real-time thread, so no file I/O there: all
+ * samples are preloaded into RAM at startup (mind the Slug's 32 MB), and
+ * the status LED is set from the main thread. Debug messages are still
+ * printed from the callback; keep -d off with short periods.
+ *
+ * Copyright (C) Jean Zundel <jzu@free.fr> 2010
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <jack/jack.h>
+#include "slampler.h"
+
+#define JACKLEN 1024       /* Frames converted at a time */
+#define LED_MS  50         /* Status LED refresh */
+
+jack_client_t *client;
+jack_port_t   *port_out [2],
+              *port_in  [2];
+
+short *jackbuf;                      // Engine side, interleaved 16-bit
+
+int   jack_open (char *device, int capt);
+void  jack_run ();
+
+struct backend jack_backend = { "jack", jack_open, jack_run };
+
+
+/****************************************************************************
+ * process()
+ *
+ * JACK callback
+ * The engine renders 16-bit frames, converted to float on the way out,
+ * which is the only place the samples are touched
+ * Periods longer than JACKLEN are done in several chunks
+ * nframes  Number of frames
+ * *arg     Unused
+ ****************************************************************************/
+
+int process (jack_nframes_t nframes, void *arg) {
+
+  jack_default_audio_sample_t *in_l = NULL,
+                              *in_r = NULL,
+                              *out_l,
+                              *out_r;
+  int done,
+      n,
+      i;
+
+  out_l = jack_port_get_buffer (port_out [0], nframes);
+  out_r = jack_port_get_buffer (port_out [1], nframes);
+
+  if (engine_idle ()) {                          // JACK keeps the clock
+    memset (out_l, 0, nframes * sizeof (*out_l));
+    memset (out_r, 0, nframes * sizeof (*out_r));
+    return 0;
+  }
+
+  if (port_in [0] && port_in [1]) {
+    in_l = jack_port_get_buffer (port_in [0], nframes);
+    in_r = jack_port_get_buffer (port_in [1], nframes);
+  }
+
+  for (done = 0; done < nframes; done += n) {
+    n = nframes - done;
+    if (n > JACKLEN)
+      n = JACKLEN;
+
+    if (in_l) {
+      for (i = 0; i < n; i++) {
+        jackbuf [i*2]   = (in_l [i] >= 1.0f) ? 32767 :
+                          (in_l [i] <= -1.0f) ? -32767 : in_l [i] * 32767.0f;
+        jackbuf [i*2+1] = (in_r [i] >= 1.0f) ? 32767 :
+                          (in_r [i] <= -1.0f) ? -32767 : in_r [i] * 32767.0f;
+      }
+      capture (jackbuf, n);
+      in_l += n;
+      in_r += n;
+    }
+
+    render (jackbuf, n);
+
+    for (i = 0; i < n; i++) {
+      out_l [i] = jackbuf [i*2]   * (1.0f / 32768.0f);
+      out_r [i] = jackbuf [i*2+1] * (1.0f / 32768.0f);
+    }
+    out_l += n;
+    out_r += n;
+  }
+  return 0;
+}
+
+
+/****************************************************************************
+ * jack_open()
+ *
+ * Registers the client and its ports, connects them to the physical ones
+ * *device  Unused, we connect to the physical ports
+ * capt     Register input ports too
+ ****************************************************************************/
+
+int jack_open (char *device, int capt) {
+
+  const char **ports;
+  int i;
+
+  if ((client = jack_client_open ("slampler", JackNoStartServer, NULL))
+      == NULL) {
+    ERROR (stderr, "jack - unable to connect to server\n");
+    return -1;
+  }
+  if (jack_get_sample_rate (client) != RATE)
+    ERROR (stderr, "jack - server runs at %d Hz, samples are at %d Hz\n",
+           jack_get_sample_rate (client), RATE);
+
+  rt = 1;
+  if (preload_waves () < 0)
+    return -1;
+
+  jackbuf = (short *) malloc (JACKLEN * 4);
+
+  port_out [0] = jack_port_register (client, "out_l",
+                                     JACK_DEFAULT_AUDIO_TYPE,
+                                     JackPortIsOutput, 0);
+  port_out [1] = jack_port_register (client, "out_r",
+                                     JACK_DEFAULT_AUDIO_TYPE,
+                                     JackPortIsOutput, 0);
+  port_in [0] = port_in [1] = NULL;
+  if (capt) {
+    port_in [0] = jack_port_register (client, "in_l",
+                                      JACK_DEFAULT_AUDIO_TYPE,
+                                      JackPortIsInput, 0);
+    port_in [1] = jack_port_register (client, "in_r",
+                                      JACK_DEFAULT_AUDIO_TYPE,
+                                      JackPortIsInput, 0);
+  }
+  if ((port_out [0] == NULL) || (port_out [1] == NULL)) {
+    ERROR (stderr, "jack - unable to register ports\n");
+    return -1;
+  }
+  capt_in = port_in [0] && port_in [1];
+
+  jack_set_process_callback (client, process, NULL);
+  if (jack_activate (client)) {
+    ERROR (stderr, "jack - unable to activate client\n");
+    return -1;
+  }
+
+  /* Connections to the hardware, if there's any */
+
+  ports = jack_get_ports (client, NULL, NULL,
+                          JackPortIsPhysical | JackPortIsInput);
+  if (ports != NULL) {
+    for (i = 0; (i < 2) && (ports [i] != NULL); i++)
+      jack_connect (client, jack_port_name (port_out [i]), ports [i]);
+    jack_free (ports);
+  }
+  if (port_in [0] && port_in [1]) {
+    ports = jack_get_ports (client, NULL, NULL,
+                            JackPortIsPhysical | JackPortIsOutput);
+    if (ports != NULL) {
+      for (i = 0; (i < 2) && (ports [i] != NULL); i++)
+        jack_connect (client, ports [i], jack_port_name (port_in [i]));
+      jack_free (ports);
+    }
+  }
+  return 0;
+}
+
+
+/****************************************************************************
+ * jack_run()
+ *
+ * JACK calls us, all that's left is the status LED
+ ****************************************************************************/
+
+void jack_run () {
+
+  int shown = 0;
+
+  while (1) {
+    usleep (LED_MS * 1000);
+    if (led_status != shown) {
+      shown = led_status;
+      set_led (LED_STATUS, shown);
+    }
+  }
+}
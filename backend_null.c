@@ -0,0 +1,125 @@
+/****************************************************************************
+ * Slampler : Slug Sampler
+ *
+ * Null backend
+ * No sound card needed: renders in real time, FRAMES at a time, and
+ * writes raw 16-bit stereo to a file if the device looks like a path
+ * (e.g. device=/tmp/slampler.raw), else throws it away
+ *
+ *  play -t raw -r 44100 -e signed -b 16 -c 2 /tmp/slampler.raw
+ *
+ * Copyright (C) Jean Zundel <jzu@free.fr> 2010
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "slampler.h"
+
+#define IDLE_MS 40
+
+int   sinkfd = -1;                   // Raw output file, if any
+
+short *sinkbuf;                      // Mixed audio
+
+struct timespec start;               // Of the stream
+long long sent = 0;                  // Frames since start
+
+int   null_open (char *device, int capt);
+void  null_run ();
+
+struct backend null_backend = { "null", null_open, null_run };
+
+
+/****************************************************************************
+ * next_block()
+ *
+ * Deadline of the next block, computed from the number of frames sent so
+ * that rounding errors never accumulate
+ * *t  Deadline
+ ****************************************************************************/
+
+void next_block (struct timespec *t) {
+
+  long long ns;
+
+  sent += frames;
+  ns = start.tv_nsec + sent * 1000000000LL / RATE;
+  t->tv_sec  = start.tv_sec + ns / 1000000000LL;
+  t->tv_nsec = ns % 1000000000LL;
+}
+
+
+/****************************************************************************
+ * null_open()
+ *
+ * *device  Output file, if it contains a '/'
+ * capt     Ignored, nothing to capture from
+ ****************************************************************************/
+
+int null_open (char *device, int capt) {
+
+  sinkbuf = (short *) malloc (frames * 4);
+
+  if (strchr (device, '/') != NULL) {
+    sinkfd = open (device, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (sinkfd < 0) {
+      ERROR (stderr, "null - could not write %s\n", device);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+/****************************************************************************
+ * null_run()
+ *
+ * Processing loop, paced by the monotonic clock, time kept in frames
+ * When idle, sleeps on the switches, then writes the silence it owes
+ ****************************************************************************/
+
+void null_run () {
+
+  struct timespec t,
+                  now;
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  t = start;
+
+  while (1) {
+
+    if (engine_idle ()) {
+      engine_wait (IDLE_MS);
+      clock_gettime (CLOCK_MONOTONIC, &now);
+      memset (sinkbuf, 0, frames * 4);
+      while ((t.tv_sec < now.tv_sec) ||
+             ((t.tv_sec == now.tv_sec) && (t.tv_nsec < now.tv_nsec))) {
+        if (sinkfd >= 0)
+          write (sinkfd, sinkbuf, frames * 4);
+        next_block (&t);
+      }
+      continue;
+    }
+
+    render (sinkbuf, frames);
+    if (sinkfd >= 0)
+      write (sinkfd, sinkbuf, frames * 4);
+
+    next_block (&t);
+    clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+  }
+}
@@ -0,0 +1,442 @@
+/****************************************************************************
+ * Slampler : Slug Sampler
+ *
+ * Microbenchmarks
+ * Times each part of the audio path on its own, on synthetic data which
+ * is the same from one run to the next. Best of REPEAT runs is kept.
+ *
+ *  make bench && ./bench [-p]
+ *
+ * -p adds cache and branch misses (and CPU cycles) from perf_event_open(),
+ * where the kernel lets us have them. Without it, cycles come from the
+ * time stamp counter on x86, which ticks at a fixed reference rate rather
+ * than the core clock, and are not reported elsewhere.
+ *
+ * Copyright (C) Jean Zundel <jzu@free.fr> 2010
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ ****************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "slampler.h"
+
+#define REPEAT   7         /* Best of */
+#define MAXVOICE 64
+#define BENCHDIR "/tmp/slampler-bench"
+#define BENCHCFG BENCHDIR "/slampler.conf"
+
+#define NCOUNT 3           /* Cycles, cache misses, branch misses */
+
+int   perf = 0;                      // -p
+int   perf_fd [NCOUNT];
+
+unsigned int seed = 1;               // Same noise every run
+
+short *mixbuf,                       // Mix destination
+      *voice [MAXVOICE];             // One stereo buffer per voice
+
+int   *srcbuf,                       // Effects input, voice 0 at -3 dB
+      *busbuf,
+      *masterbuf;
+
+void  setup ();
+void  cleanup ();
+
+
+/****************************************************************************
+ * noise()
+ *
+ * Deterministic white noise at -6 dB, an LCG is plenty
+ ****************************************************************************/
+
+short noise () {
+
+  seed = seed * 1103515245 + 12345;
+  return (short) (seed >> 16) / 2;
+}
+
+
+/****************************************************************************
+ * tsc()
+ *
+ * Time stamp counter, 0 where we don't know how to read it
+ ****************************************************************************/
+
+unsigned long long tsc () {
+
+#if defined (__i386__) || defined (__x86_64__)
+  unsigned int lo,
+               hi;
+
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((unsigned long long) hi << 32) | lo;
+#else
+  return 0;
+#endif
+}
+
+
+/****************************************************************************
+ * counters_open()
+ *
+ * Hardware counters for this thread, user space only
+ * Any of them may be missing (-1), e.g. in a VM or with perf_event_paranoid
+ ****************************************************************************/
+
+void counters_open () {
+
+  struct perf_event_attr pe;
+  unsigned long long config [NCOUNT] = { PERF_COUNT_HW_CPU_CYCLES,
+                                         PERF_COUNT_HW_CACHE_MISSES,
+                                         PERF_COUNT_HW_BRANCH_MISSES };
+  int c;
+
+  for (c = 0; c < NCOUNT; c++) {
+    memset (&pe, 0, sizeof (pe));
+    pe.type = PERF_TYPE_HARDWARE;
+    pe.size = sizeof (pe);
+    pe.config = config [c];
+    pe.disabled = 1;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    perf_fd [c] = syscall (__NR_perf_event_open, &pe, 0, -1, -1, 0);
+    if (perf_fd [c] < 0)
+      fprintf (stderr, "perf counter %d unavailable\n", c);
+  }
+}
+
+
+/****************************************************************************
+ * bench()
+ *
+ * Runs fn (iters) REPEAT times after a warmup, prints the best run
+ * *name   Label
+ * fn      Function under test, repeats its job iters times
+ * iters   Number of jobs per run
+ * n       Frames processed by one job, 0 if not relevant
+ ****************************************************************************/
+
+void bench (char *name, void (*fn) (int), int iters, int n) {
+
+  long long t,
+            best = 0;
+  unsigned long long c,
+                     cyc = 0;
+  long long count [NCOUNT],
+            keep [NCOUNT];
+  int r,
+      i;
+
+  for (i = 0; i < NCOUNT; i++)
+    keep [i] = -1;
+  fn (iters / 10 + 1);                           // Warm caches up
+
+  for (r = 0; r < REPEAT; r++) {
+    for (i = 0; perf && (i < NCOUNT); i++)
+      if (perf_fd [i] >= 0) {
+        ioctl (perf_fd [i], PERF_EVENT_IOC_RESET, 0);
+        ioctl (perf_fd [i], PERF_EVENT_IOC_ENABLE, 0);
+      }
+    c = tsc ();
+    t = clock_ns (CLOCK_MONOTONIC);
+    fn (iters);
+    t = clock_ns (CLOCK_MONOTONIC) - t;
+    c = tsc () - c;
+    for (i = 0; i < NCOUNT; i++) {
+      count [i] = -1;
+      if (perf && (perf_fd [i] >= 0)) {
+        ioctl (perf_fd [i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read (perf_fd [i], &count [i], sizeof (long long))
+            != sizeof (long long))
+          count [i] = -1;
+      }
+    }
+    if ((r == 0) || (t < best)) {
+      best = t;
+      cyc = c;
+      memcpy (keep, count, sizeof (keep));
+    }
+  }
+
+  if (keep [0] >= 0)                             // Real cycles beat TSC
+    cyc = keep [0];
+
+  printf ("%-22s %10.1f ns/op", name, (double) best / iters);
+  if (n) {
+    printf (" %8.2f ns/frame", (double) best / iters / n);
+    if (cyc)
+      printf (" %7.2f cyc/sample", (double) cyc / iters / n / 2);
+    else
+      printf ("        - cyc/sample");
+  }
+  if (perf) {
+    if (keep [1] >= 0)
+      printf (" %9.2f cmiss/op", (double) keep [1] / iters);
+    if (keep [2] >= 0)
+      printf (" %9.2f bmiss/op", (double) keep [2] / iters);
+  }
+  printf ("\n");
+}
+
+
+/****************************************************************************
+ * Jobs
+ ****************************************************************************/
+
+int nvoice;                          // For job_mix()
+
+void job_load (int iters) {
+
+  while (iters--)
+    load_waves (0);
+}
+
+void job_upmix (int iters) {
+
+  while (iters--)
+    upmix (voice [0], FRAMES);
+}
+
+void job_mix (int iters) {
+
+  int v;
+
+  while (iters--) {
+    memset (mixbuf, 0, FRAMES * 4);
+    for (v = 0; v < nvoice; v++)
+      mixclip (mixbuf, voice [v], FRAMES);
+  }
+}
+
+void job_bus (int iters) {
+
+  while (iters--) {
+    memset (busbuf, 0, FRAMES * 2 * sizeof (int));
+    mixbus (busbuf, voice [0], FRAMES);
+    clip (mixbuf, busbuf, FRAMES);
+  }
+}
+
+void job_eq (int iters) {
+
+  while (iters--) {
+    memcpy (busbuf, srcbuf, FRAMES * 2 * sizeof (int));
+    biquad (&chain [0].eq, busbuf, FRAMES);
+  }
+}
+
+void job_delay (int iters) {
+
+  while (iters--) {
+    memcpy (busbuf, srcbuf, FRAMES * 2 * sizeof (int));
+    delay (&chain [0].dl, busbuf, FRAMES);
+  }
+}
+
+void job_reverb (int iters) {
+
+  while (iters--) {
+    memcpy (fxsend, srcbuf, FRAMES * sizeof (int));
+    reverb (fxsend, masterbuf, FRAMES);
+  }
+}
+
+void job_chain (int iters) {
+
+  while (iters--) {
+    memset (masterbuf, 0, FRAMES * 2 * sizeof (int));
+    memset (busbuf, 0, FRAMES * 2 * sizeof (int));
+    mixbus (busbuf, voice [0], FRAMES);
+    fx_bank (0, busbuf, masterbuf, FRAMES);
+    fx_master (masterbuf, FRAMES);
+    clip (mixbuf, masterbuf, FRAMES);
+  }
+}
+
+void job_trigger (int iters) {
+
+  int s = 0;
+
+  while (iters--) {
+    smpl_flag [s] = 1;                           // As the switch threads do
+    wake ();
+    engine_wait (0);
+    triggers ();
+    if (++s == nsmpls)
+      s = 0;
+  }
+}
+
+void job_config (int iters) {
+
+  while (iters--)
+    config (BENCHCFG);
+}
+
+
+/****************************************************************************
+ * main()
+ ****************************************************************************/
+
+int main (int argc, char **argv) {
+
+  cpu_set_t cpus;
+  char name [32];
+  int s;
+
+  if ((argc > 1) && (!strcmp (argv [1], "-p")))
+    perf = 1;
+
+  CPU_ZERO (&cpus);                              // No migrations
+  CPU_SET (0, &cpus);
+  sched_setaffinity (0, sizeof (cpus), &cpus);
+
+  if (perf)
+    counters_open ();
+
+  setup ();
+
+  printf ("slampler bench, %d frames/op, best of %d, cycles from %s\n\n",
+          FRAMES, REPEAT,
+          (perf && (perf_fd [0] >= 0)) ? "perf (core)" :
+          tsc () ? "TSC (reference, not core)" : "nowhere");
+
+  bench ("bank load (5 WAVs)", job_load,     2000, 0);
+  bench ("upmix",              job_upmix,  200000, FRAMES);
+  for (nvoice = 1; nvoice <= MAXVOICE; nvoice *= 2) {
+    sprintf (name, "mix/clip %2d voices", nvoice);
+    bench (name,               job_mix,    200000 / nvoice, FRAMES);
+  }
+
+  /* Triggers on RAM takes, so that we don't time open() */
+
+  for (s = 0; s < nsmpls; s++) {
+    wave [0][s].ram = voice [s];
+    wave [0][s].ramlen = FRAMES;
+  }
+  bench ("trigger + wakeup",   job_trigger, 200000, 0);
+
+  /* Effects on bank 0, see setup () */
+
+  bench ("bus mix + clip",     job_bus,    200000, FRAMES);
+  bench ("fx eq",              job_eq,     200000, FRAMES);
+  bench ("fx delay",           job_delay,  200000, FRAMES);
+  bench ("fx reverb",          job_reverb, 200000, FRAMES);
+  bench ("fx eq+delay+reverb", job_chain,  100000, FRAMES);
+  for (s = 0; s < nsmpls; s++) {
+    wave [0][s].ram = NULL;
+    wave [0][s].live = 0;
+  }
+
+  bench ("config parse",       job_config,  20000, 0);
+
+  cleanup ();
+  return 0;
+}
+
+
+/****************************************************************************
+ * setup()
+ *
+ * One bank of five short mono WAVs and a config file in BENCHDIR,
+ * voice buffers full of noise, an effect of each kind on bank 0
+ ****************************************************************************/
+
+void setup () {
+
+  struct RIFFfmtdata head;
+  char  path [256];
+  short data [4410];
+  int   fd,
+        s,
+        i;
+  FILE  *f;
+
+  nbanks = 1;
+  nsmpls = 5;
+  strcpy (datadir, BENCHDIR);
+  fx_parse ("eq", "0 peak 800 -6 1.0");
+  fx_parse ("delay", "0 0.75 0.4 0.3");
+  fx_parse ("reverb", "0 0.25");
+  engine_init ();
+
+  mkdir (BENCHDIR, 0755);
+  mkdir (BENCHDIR "/0", 0755);
+
+  for (s = 0; s < nsmpls; s++) {
+    sprintf (path, "%s/0/%c.wav", BENCHDIR, 'e' - s);    // Needs sorting
+    for (i = 0; i < 4410; i++)
+      data [i] = noise ();
+    wav_header (&head, 1, sizeof (data));
+    if ((fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+      perror (path);
+      exit (EXIT_FAILURE);
+    }
+    write (fd, &head, sizeof (head));
+    write (fd, data, sizeof (data));
+    close (fd);
+  }
+
+  if ((f = fopen (BENCHCFG, "w")) != NULL) {
+    fprintf (f, "# slampler.conf sample file\n"
+                "#\n"
+                "# Syntax is more or less free-form\n\n"
+                "output = alsa\n"
+                "device=plughw:0\n"
+                "banks = 1\n"
+                "samples 5\n"
+                "capture = 0\n");
+    fclose (f);
+  }
+
+  mixbuf = (short *) malloc (FRAMES * 4);
+  srcbuf = (int *) calloc (FRAMES * 2, sizeof (int));
+  busbuf = (int *) calloc (FRAMES * 2, sizeof (int));
+  masterbuf = (int *) calloc (FRAMES * 2, sizeof (int));
+  for (i = 0; i < MAXVOICE; i++) {
+    voice [i] = (short *) malloc (FRAMES * 4);
+    for (s = 0; s < FRAMES * 2; s++)
+      voice [i][s] = noise ();
+  }
+  mixbus (srcbuf, voice [0], FRAMES);
+}
+
+
+/****************************************************************************
+ * cleanup()
+ ****************************************************************************/
+
+void cleanup () {
+
+  char path [256];
+  int  s;
+
+  for (s = 0; s < nsmpls; s++) {
+    sprintf (path, "%s/0/%c.wav", BENCHDIR, 'e' - s);
+    unlink (path);
+  }
+  unlink (BENCHCFG);
+  rmdir (BENCHDIR "/0");
+  rmdir (BENCHDIR);
+}
@@ -0,0 +1,101 @@
+/****************************************************************************
+ * Slampler : Slug Sampler
+ *
+ * Configuration file
+ *
+ * Copyright (C) Jean Zundel <jzu@free.fr> 2010 
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slampler.h"
+
+#define PRMLEN 512
+#define NP 10
+
+char device [256];                   // Audio device we're using (cfg)
+char output [256];                   // Audio backend (cfg)
+
+
+/****************************************************************************
+ * config()
+ * 
+ * Unsafe config.ini-style parsing routine. Fits the bill. Kids, do not try 
+ * this at home. Use https://github.com/ndevilla/iniparser instead.
+ * *path  Config file
+ ****************************************************************************/
+
+void config (char *path) {
+
+  FILE *config;
+
+  const char *param [] = {"device", "banks", "samples",  /* NP */
+                          "capture", "dump", "output",
+                          "tempo", "eq", "delay", "reverb"};
+
+  char line [PRMLEN];
+  char value [PRMLEN];
+
+  int p;
+  int i;
+  int j;
+
+  if ((config = fopen (path, "r")) != NULL) {
+    while (fgets (line, PRMLEN, config) != NULL) {
+      for (p = 0; p < NP; p++) {
+        if (strstr (line, param [p]) == line) {
+          i = strlen (param [p]);
+          while ((line [i] != 0) &&
+                 ((line [i] == ' ') ||
+                  (line [i] == '\t') ||
+                  (line [i] == '='))) 
+            i++;
+          j = 0;
+          while ((line [i] != 0) &&
+                 (line [i] != 10) &&
+                 (line [i] != 13)) {
+            value [j]  = line [i];
+            i++;
+            j++;
+          }
+          value [j] = '\0';
+          if (strcmp (param [p], "device") == 0)
+            strcpy (device, value);
+          else 
+          if (strcmp (param [p], "banks") == 0)
+            nbanks = atoi (value);
+          else 
+          if (strcmp (param [p], "samples") == 0)
+            nsmpls = atoi (value);
+          else 
+          if (strcmp (param [p], "capture") == 0)
+            capt_secs = atoi (value);
+          else 
+          if (strcmp (param [p], "dump") == 0)
+            strcpy (dumpdir, value);
+          else 
+          if (strcmp (param [p], "output") == 0)
+            strcpy (output, value);
+          else 
+          if (strcmp (param [p], "tempo") == 0)
+            tempo = atoi (value);
+          else 
+            fx_parse ((char *) param [p], value);        // eq, delay, reverb
+        }
+      } 
+    }
+    fclose (config);
+  }
+}
@@ -0,0 +1,856 @@
+/****************************************************************************
+ * Slampler : Slug Sampler
+ *
+ * Mix engine: sample banks, triggers, mixing, capture
+ * Knows nothing about the audio hardware - backends call render() and
+ * capture() from their own loop or callback
+ *
+ * Copyright (C) Jean Zundel <jzu@free.fr> 2010 
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <limits.h>
+#include <dirent.h>
+#include <poll.h>
+#include "slampler.h"
+
+#define STATS 10           /* Seconds between idle/active reports */
+
+struct wcb **wave;                   // [nbanks][nsmpls]
+
+int *smpl_flag;                      // Which sample to start now
+int  rec_flag = 0;                   // Record switch activated
+
+int  nsmpls = 5;                     // Number of samples per bank (cfg)
+int  nbanks = 3;                     // Number of banks (cfg)
+int  capt_secs = 0;                  // Capture slot length, 0 = off (cfg)
+int  capt_in = 0;                    // The backend feeds capture()
+char dumpdir [256];                  // Where to save takes, "" = don't (cfg)
+char datadir [128] = DATADIR;        // Where the banks are
+
+int  bank = 0;                       // Current bank
+
+int  frames = FRAMES;
+
+int  debug = 0;
+
+short *filebuf;                      // Read from file
+
+int   *bus,                          // One bank, when there are effects
+      *master;                       // All banks, before clipping
+
+// Idle mode
+
+int   nlive = 0;                     // Samples and takes playing
+int   quiet = 0;                     // Frames of silent effect tails
+int   wake_fd [2];                   // Switches -> audio loop
+int   idle = 0;                      // Current mode
+long long mode_wall,                 // When it started
+          mode_cpu,
+          stat_wall [2],             // Time spent [active, idle]
+          stat_cpu [2],              // CPU time spent [active, idle]
+          stat_last;                 // Last report
+
+// Capture
+
+short      *take [NTAKES];           // Preallocated capture slots
+struct wcb *take_owner [NTAKES];     // Sample slot playing each take
+int         take_next = 0;           // Round robin
+int         take_len;                // Slot size in frames
+
+struct wcb *capt = NULL;             // Slot being recorded, if any
+short      *capt_buf;
+int         capt_take;               // Its take index
+int         capt_pos;                // Frames recorded so far
+int         armed = 0;               // Next sample switch records
+
+int   rt = 0;                        // Called from a real-time callback
+volatile int led_status = 0;         // Status LED, set by the backend if rt
+
+// Takes on their way to disk, saved straight from RAM - a queued take
+// is not recorded over until the disk writer is done with it
+
+int   dump_take [NTAKES];            // Take index
+int   dump_len [NTAKES];             // Frames
+volatile unsigned int dump_in = 0,   // Takes queued by the audio loop
+                      dump_out = 0;  // Takes saved by the disk writer
+
+int   silent (int *master, int n);
+int   take_busy (int t);
+void  status_led (int on);
+void  capt_start (struct wcb *w);
+void  capt_stop ();
+
+
+/****************************************************************************
+ * engine_init()
+ *
+ * Allocates everything the audio path will ever need, once config() has
+ * told us how much
+ ****************************************************************************/
+
+void engine_init () {
+
+  int i;
+
+  wave = (struct wcb **) malloc (nbanks * sizeof (struct wcb *));
+  for (i = 0; i < nbanks; i++)
+    wave [i] = (struct wcb *) calloc (nsmpls, sizeof (struct wcb));
+
+  smpl_flag = (int *) calloc (nsmpls, sizeof (int));
+
+  if (pipe (wake_fd) == 0) {
+    fcntl (wake_fd [0], F_SETFL, O_NONBLOCK);
+    fcntl (wake_fd [1], F_SETFL, O_NONBLOCK);
+  }
+
+  filebuf = (short *) malloc (frames * 4);
+
+  if (fx_init ()) {
+    bus    = (int *) malloc (frames * 2 * sizeof (int));
+    master = (int *) malloc (frames * 2 * sizeof (int));
+  }
+
+  /* Capture slots, allocated once and for all - no malloc() on stage */
+
+  if (capt_secs > 0) {
+    take_len = capt_secs * RATE;
+    for (i = 0; i < NTAKES; i++) {
+      take [i] = (short *) malloc (take_len * 4);
+      take_owner [i] = NULL;
+    }
+  }
+}
+
+
+/****************************************************************************
+ * clock_ns()
+ *
+ * Time in ns
+ * clk  CLOCK_MONOTONIC or CLOCK_THREAD_CPUTIME_ID
+ ****************************************************************************/
+
+long long clock_ns (clockid_t clk) {
+
+  struct timespec t;
+
+  clock_gettime (clk, &t);
+  return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+
+/****************************************************************************
+ * render()
+ *
+ * Backend callback: mixes n stereo frames into out, FRAMES at a time,
+ * taking switches into account between each chunk
+ * *out  Interleaved stereo, 16-bit, owned by the backend
+ * n     Number of frames
+ ****************************************************************************/
+
+void render (short *out, int n) {
+
+  int k;
+
+  while (n > 0) {
+    k = (n < frames) ? n : frames;
+    triggers ();
+    mix (out, k);
+    out += k * 2;
+    n -= k;
+  }
+}
+
+
+/****************************************************************************
+ * wake()
+ *
+ * Called by the switch threads once they've raised a flag, so that an
+ * idle audio loop gets back to work at once
+ ****************************************************************************/
+
+void wake () {
+
+  write (wake_fd [1], "", 1);                    // Pipe full? Already awake
+}
+
+
+/****************************************************************************
+ * engine_wait()
+ *
+ * Sleeps until a switch is activated, or for ms milliseconds
+ * Returns 1 if woken up by a switch
+ * ms  Timeout
+ ****************************************************************************/
+
+int engine_wait (int ms) {
+
+  struct pollfd p;
+  char  c [64];
+  int   rc;
+
+  p.fd = wake_fd [0];
+  p.events = POLLIN;
+  rc = poll (&p, 1, ms);
+  if (rc > 0)
+    while (read (wake_fd [0], c, sizeof (c)) > 0)
+      ;
+  return rc > 0;
+}
+
+
+/****************************************************************************
+ * engine_idle()
+ *
+ * Backend loop side: handles pending switches, then tells whether there is
+ * anything to render at all - no sample, no take being recorded, effect
+ * tails died out. If not, the backend feeds silence the cheap way.
+ * In debug mode, reports the share of time and CPU spent in each mode.
+ ****************************************************************************/
+
+int engine_idle () {
+
+  long long wall,
+            cpu;
+  int now;
+
+  triggers ();
+  now = (nlive == 0) && (capt == NULL) && (! fx_on || (quiet >= fx_tail));
+
+  if ((now == idle) && ! debug)
+    return now;
+
+  wall = clock_ns (CLOCK_MONOTONIC);
+  if ((now != idle) || (wall - stat_last >= STATS * 1000000000LL)) {
+    cpu = clock_ns (CLOCK_THREAD_CPUTIME_ID);
+    if (mode_wall) {
+      stat_wall [idle] += wall - mode_wall;
+      stat_cpu [idle]  += cpu - mode_cpu;
+    }
+    mode_wall = wall;
+    mode_cpu  = cpu;
+    idle = now;
+  }
+  if (stat_last == 0)
+    stat_last = wall;
+  if (wall - stat_last >= STATS * 1000000000LL) {
+    DEBUG ("idle %5.1f%% of the time, %5.2f%% CPU; "
+           "active %5.1f%%, %5.2f%% CPU\n",
+           stat_wall [1] * 100.0 / (wall - stat_last),
+           stat_wall [1] ? stat_cpu [1] * 100.0 / stat_wall [1] : 0.0,
+           stat_wall [0] * 100.0 / (wall - stat_last),
+           stat_wall [0] ? stat_cpu [0] * 100.0 / stat_wall [0] : 0.0);
+    stat_wall [0] = stat_wall [1] = 0;
+    stat_cpu [0]  = stat_cpu [1]  = 0;
+    stat_last = wall;
+  }
+  return now;
+}
+
+
+/****************************************************************************
+ * triggers()
+ *
+ * Handles switches activated since the last chunk
+ ****************************************************************************/
+
+void triggers () {
+
+  int s;
+
+  /* Record switch: arm, or stop the current take */
+
+  if (rec_flag) {
+    rec_flag = 0;
+    if (capt)
+      capt_stop ();
+    else
+    if ((capt_secs > 0) && capt_in) {
+      armed ^= 1;
+      status_led (armed);
+      DEBUG ("%s\n", armed ? "armed" : "disarmed");
+    }
+  }
+
+  /* Has a new sample been activated ? */
+
+  for (s = 0; s < nsmpls; s++)
+    if (smpl_flag [s]) {
+      smpl_flag [s] = 0;
+      if (armed) {
+        armed = 0;
+        capt_start (&wave [bank][s]);
+        continue;
+      }
+      if (&wave [bank][s] == capt)            // Being recorded
+        continue;
+      if (wave [bank][s].ram) {
+        if (! wave [bank][s].live)
+          nlive++;
+        wave [bank][s].pos  = 0;              // Restart the take
+        wave [bank][s].live = 1;
+        DEBUG ("start %d-%d (ram)\n", bank, s);
+        continue;
+      }
+      if (wave [bank][s].fd)
+        nlive--;
+      if (wave [bank][s].fd > 0) {
+        close (wave [bank][s].fd);            // Only one instance at a time
+        wave [bank][s].fd = 0;                // Closed, will be restarted
+      }
+      if (wave [bank][s].head.size)
+        wave [bank][s].fd = open (wave [bank][s].path, O_RDONLY);
+      if (wave [bank][s].fd)
+        nlive++;
+      DEBUG ("start %d-%d (%s) = %d\n", 
+             bank, s, wave[bank][s].path, wave[bank][s].fd);
+    }
+}
+
+
+/****************************************************************************
+ * mix()
+ *
+ * Reads and mixes active samples
+ * With effects, each bank goes through its own bus, clipping happens once
+ * *playbuf  Interleaved stereo destination
+ * n         Number of frames, up to FRAMES
+ ****************************************************************************/
+
+void mix (short *playbuf, int n) {
+
+  int s,                             // Sample index
+      b;                             // Bank index
+  int len,                           // Read from file
+      res;                           // Result for file operations
+
+  if (fx_on)
+    memset (master, 0, n * 2 * sizeof (int));
+  else {
+    memset (playbuf, 0, n*4);                            // Stereo, 16-bit
+    if (nlive == 0)
+      return;
+  }
+                                            
+  for (b = 0; b < nbanks; b++) {
+    if (fx_on)
+      memset (bus, 0, n * 2 * sizeof (int));
+    for (s = 0; (s < nsmpls) && nlive; s++)
+      if (wave [b][s].fd || wave [b][s].live) {
+        if (wave [b][s].live) {                          // Take, from RAM
+          len = n * 4;
+          res = (wave [b][s].ramlen - wave [b][s].pos) * 4;
+          if (res > len)
+            res = len;
+          memcpy (filebuf, wave [b][s].ram + wave [b][s].pos * 2, res);
+          memset ((char *) filebuf + res, 0, len - res);
+          wave [b][s].pos += res / 4;
+        }
+        else {
+          len = n * 2 * wave [b][s].head.numchannels;
+          res = read (wave [b][s].fd, 
+                      filebuf, 
+                      len);
+          if (len == n * 2)                              // Mono to stereo
+            upmix (filebuf, n);
+        }
+        if (fx_on)
+          mixbus (bus, filebuf, n);
+        else
+          mixclip (playbuf, filebuf, n);
+        if (res < len) {
+          if (wave [b][s].live)
+            wave [b][s].live = 0;
+          else {
+            close (wave [b][s].fd);                      // Hoc finiunt samples
+            wave [b][s].fd = 0;
+          }
+          nlive--;
+          DEBUG ("stop  %d-%d\n", b, s);
+        }
+      }
+    if (fx_on)
+      fx_bank (b, bus, master, n);
+  }
+
+  if (fx_on) {
+    fx_master (master, n);
+    clip (playbuf, master, n);
+    if (nlive)
+      quiet = 0;
+    else
+    if (silent (master, n))
+      quiet += n;
+    else
+      quiet = 0;
+  }
+}
+
+
+/****************************************************************************
+ * silent()
+ *
+ * Returns 1 if a block is below 1 LSB or so, i.e. what's left of the
+ * effect tails once integer rounding has had its way
+ * *master  32-bit interleaved stereo
+ * n        Number of frames
+ ****************************************************************************/
+
+int silent (int *master, int n) {
+
+  int i;
+
+  for (i = 0; i < n*2; i++)
+    if ((master [i] > 2) || (master [i] < -2))
+      return 0;
+  return 1;
+}
+
+
+/****************************************************************************
+ * upmix()
+ *
+ * Mono to stereo, in place, from the end
+ * *buf  n mono samples in, n stereo frames out
+ * n     Number of frames
+ ****************************************************************************/
+
+void upmix (short *buf, int n) {
+
+  int i;
+
+  for (i = n-1; i >= 0; i--)
+    buf [i*2] = buf [i*2+1] = buf [i];
+}
+
+
+/****************************************************************************
+ * mixclip()
+ *
+ * Adds a sample to the mix at -3 dB, clipping instead of rolling over
+ * *playbuf  Mix, interleaved stereo
+ * *filebuf  Sample, interleaved stereo
+ * n         Number of frames
+ ****************************************************************************/
+
+void mixclip (short *playbuf, short *filebuf, int n) {
+
+  int i;
+
+  for (i = 0; i < n*2; i += 2) {
+    if ((playbuf [i] > 0) &&
+        (filebuf [i] > 0) &&
+        (playbuf [i] + filebuf [i]/2 < 0))
+      playbuf [i] = playbuf [i+1] = SHRT_MAX;            // Prevents rollovers
+    else 
+    if ((playbuf [i] < 0) &&
+        (filebuf [i] < 0) &&
+        (playbuf [i] + filebuf [i]/2 > 0))
+      playbuf [i] = playbuf [i+1] = SHRT_MIN;
+    else {
+      playbuf [i]   += filebuf [i]/2;                    // Mix (-3 dB)
+      playbuf [i+1] += filebuf [i+1]/2;
+    }
+  }
+}
+
+
+/****************************************************************************
+ * mixbus()
+ *
+ * Adds a sample to a bank bus at -3 dB, no clipping yet
+ * *bus      32-bit interleaved stereo
+ * *filebuf  Sample, interleaved stereo
+ * n         Number of frames
+ ****************************************************************************/
+
+void mixbus (int *bus, short *filebuf, int n) {
+
+  int i;
+
+  for (i = 0; i < n*2; i++)
+    bus [i] += filebuf [i] / 2;
+}
+
+
+/****************************************************************************
+ * clip()
+ *
+ * Master bus to 16-bit
+ * *playbuf  Interleaved stereo destination
+ * *master   32-bit interleaved stereo
+ * n         Number of frames
+ ****************************************************************************/
+
+void clip (short *playbuf, int *master, int n) {
+
+  int i;
+
+  for (i = 0; i < n*2; i++)
+    playbuf [i] = (master [i] > SHRT_MAX) ? SHRT_MAX :
+                  (master [i] < SHRT_MIN) ? SHRT_MIN : master [i];
+}
+
+
+/****************************************************************************
+ * capture()
+ *
+ * Backend callback: incoming audio, kept only while recording
+ * *in  Interleaved stereo, 16-bit, owned by the backend
+ * n    Number of frames
+ ****************************************************************************/
+
+void capture (short *in, int n) {
+
+  if (! capt)
+    return;
+  if (n > take_len - capt_pos)
+    n = take_len - capt_pos;
+  memcpy (capt_buf + capt_pos * 2, in, n * 4);
+  capt_pos += n;
+  if (capt_pos == take_len)
+    capt_stop ();                                        // Slot full
+}
+
+
+/****************************************************************************
+ * status_led()
+ *
+ * Record LED - a sysfs write may block, so a real-time backend sets it
+ * from its own thread
+ * on  0 or 1
+ ****************************************************************************/
+
+void status_led (int on) {
+
+  led_status = on;
+  if (! rt)
+    set_led (LED_STATUS, on);
+}
+
+
+/****************************************************************************
+ * take_busy()
+ *
+ * Tells whether a take is queued for the disk writer
+ * t  Take index
+ ****************************************************************************/
+
+int take_busy (int t) {
+
+  unsigned int i;
+
+  for (i = dump_out; i != dump_in; i++)
+    if (dump_take [i % NTAKES] == t)
+      return 1;
+  return 0;
+}
+
+
+/****************************************************************************
+ * capt_start()
+ *
+ * Starts recording into a sample slot, reusing its take if it has one,
+ * else the oldest preallocated one - skipping those not saved to disk yet
+ * *w  Sample slot
+ ****************************************************************************/
+
+void capt_start (struct wcb *w) {
+
+  int t,
+      i;
+
+  for (t = 0; (t < NTAKES) && (take_owner [t] != w); t++)
+    ;
+  if ((t < NTAKES) && take_busy (t)) {
+    take_owner [t] = NULL;                       // Keeps playing until saved
+    t = NTAKES;
+  }
+  if (t == NTAKES) {
+    for (i = 0; (i < NTAKES) && take_busy (take_next); i++)
+      take_next = (take_next + 1) % NTAKES;
+    if (take_busy (take_next)) {
+      ERROR (stderr, "rec - disk writer behind, not recording\n");
+      status_led (0);
+      return;
+    }
+    t = take_next;
+    take_next = (take_next + 1) % NTAKES;
+    if (take_owner [t] && (take_owner [t] != w)) {        // Evict
+      if (take_owner [t]->live)
+        nlive--;
+      take_owner [t]->ram    = take_owner [t]->file;     // Or NULL
+      take_owner [t]->ramlen = take_owner [t]->filelen;
+      take_owner [t]->live   = 0;
+    }
+    take_owner [t] = w;
+  }
+
+  if (w->fd > 0) {
+    close (w->fd);
+    w->fd = 0;
+    nlive--;
+  }
+  if (w->live) {
+    w->live = 0;
+    nlive--;
+  }
+  w->ram = NULL;                                 // Silent while recording
+  capt = w;
+  capt_take = t;
+  capt_buf = take [t];
+  capt_pos = 0;
+  status_led (1);
+  DEBUG ("rec   %s\n", w->path);
+}
+
+
+/****************************************************************************
+ * capt_stop()
+ *
+ * Ends the current take, which becomes playable at once from RAM
+ * Queues it for the disk writer
+ ****************************************************************************/
+
+void capt_stop () {
+
+  capt->ram    = capt_buf;
+  capt->ramlen = capt_pos;
+  capt = NULL;
+
+  if (dumpdir [0] && capt_pos) {
+    dump_take [dump_in % NTAKES] = capt_take;    // Can't be full, see above
+    dump_len [dump_in % NTAKES]  = capt_pos;
+    __sync_synchronize ();
+    dump_in++;
+  }
+  status_led (0);
+  DEBUG ("rec   stop, %d frames\n", capt_pos);
+}
+
+
+/****************************************************************************
+ * load_waves()
+ *
+ * Loads .WAVs from a (numerically named) directory for a sample bank
+ * All files at 44100 Hz, 2 bytes/sample, mono or stereo, normalized at -3dB
+ *
+ * rep  Number for directory name (should be 0,1,2...)
+ ****************************************************************************/
+
+void load_waves (int rep) {
+
+  DIR *dirp;
+  struct dirent *dp;
+  int f,
+      g;
+  int wfile;
+  char repname [256];
+
+  char *name [5];                                 // Sort vars
+  char *s;
+  int  mod;
+
+  memset (name, 0, sizeof (char *) * nsmpls);
+  s = malloc (256);
+
+  sprintf (repname, "%s/%d", datadir, rep);
+  if ((dirp = opendir (repname)) != NULL) {
+    f = 0;
+    while (((dp = readdir (dirp)) != NULL) && 
+           (f < nsmpls)) {
+      if (dp->d_name[0] != '.') {
+        name [f] = malloc (256);
+        strcpy (name [f], dp->d_name);
+        f++;
+      }
+    }
+    for (f = 0; f < nsmpls-1; f++) {             // Bubble sort
+      for (g = 0, mod = 0; 
+           (g < nsmpls-1) && (name [g+1] != NULL); 
+           g++) {
+        if (strcmp (name [g], name [g+1]) > 0 ) {
+          mod = 1;
+          s = name [g];
+          name [g] = name [g+1];
+          name [g+1] = s;
+        }
+      }
+      if (! mod)
+        f = nsmpls;                              // Completed, exit
+    }
+    for (f = 0; 
+         (f < nsmpls) && (name [f] != NULL); 
+         f++) {
+      sprintf (wave [rep][f].path, "%s/%d/%s", 
+               datadir, 
+               rep, 
+               name [f]);
+      wfile = open (wave [rep][f].path, O_RDONLY);
+      read (wfile, 
+            &wave [rep][f].head, 
+            sizeof (struct RIFFfmtdata));
+      DEBUG ("%10d  %s\n", wave [rep][f].head.size, wave [rep][f].path);
+      close (wfile);
+    }
+    closedir (dirp);
+
+    for (f = 0; (f < nsmpls) && (name [f] != NULL); f++)
+      free (name [f]);
+
+    return;
+  }
+  else {
+    ERROR (stderr,
+           "Could not read %s\n", repname);
+  }
+}
+
+
+/****************************************************************************
+ * preload_waves()
+ *
+ * Reads every sample into RAM, for backends which can't afford file I/O
+ * while rendering: they then play just like takes, and come back when a
+ * take evicts them
+ * Returns -1 if memory runs out
+ ****************************************************************************/
+
+int preload_waves () {
+
+  struct wcb *w;
+  int b,
+      s,
+      ch,
+      fd,
+      n,
+      total = 0;
+
+  for (b = 0; b < nbanks; b++)
+    for (s = 0; s < nsmpls; s++) {
+      w = &wave [b][s];
+      if (w->head.size <= 0)
+        continue;
+      ch = (w->head.numchannels == 1) ? 1 : 2;
+      n = w->head.size / (ch * 2);
+      if ((w->file = (short *) malloc (n * 4)) == NULL) {
+        ERROR (stderr, "Not enough memory for %s\n", w->path);
+        return -1;
+      }
+      n = 0;
+      if ((fd = open (w->path, O_RDONLY)) > 0) {
+        lseek (fd, sizeof (struct RIFFfmtdata), SEEK_SET);
+        n = read (fd, w->file, w->head.size) / (ch * 2);
+        close (fd);
+      }
+      if (n < 0)
+        n = 0;
+      if (ch == 1)
+        upmix (w->file, n);
+      w->filelen = n;
+      w->ram     = w->file;
+      w->ramlen  = n;
+      total += n * 4;
+    }
+  DEBUG ("%10d  bytes preloaded\n", total);
+  return 0;
+}
+
+
+/**************************************************************************** 
+ * dumper()
+ *
+ * Separate thread
+ * Saves takes as WAV files in the dump directory, one file per take,
+ * straight from their RAM slot. Disk latency never reaches the audio
+ * loop, which only refuses to record once the 4 takes are waiting here.
+ ****************************************************************************/
+
+void *dumper ()
+{
+
+  char   path [512];
+  struct RIFFfmtdata head;
+  int    fd,
+         t,
+         size;
+
+  while (1) {
+    if (dump_out == dump_in) {
+      usleep (100000);
+      continue;
+    }
+    __sync_synchronize ();                       // Index before data
+    t    = dump_take [dump_out % NTAKES];
+    size = dump_len [dump_out % NTAKES] * 4;
+
+    sprintf (path, "%s/%ld-%u.wav", dumpdir, (long) time (NULL), dump_out);
+    fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+      wav_header (&head, 2, size);
+      if ((write (fd, &head, sizeof (struct RIFFfmtdata))
+           != sizeof (struct RIFFfmtdata)) ||
+          (write (fd, take [t], size) != size))
+        ERROR (stderr, "Short write to %s\n", path);
+      close (fd);
+      DEBUG ("%10d  %s\n", size, path);
+    }
+    else
+      ERROR (stderr, "Could not write %s\n", path);
+
+    __sync_synchronize ();                       // Done with the take
+    dump_out++;
+  }
+}
+
+
+/****************************************************************************
+ * wav_header()
+ *
+ * Fills a canonical 44-byte header for 16-bit, 44100 Hz PCM data
+ * *head      Header
+ * channels   1 or 2
+ * size       Data size in bytes
+ ****************************************************************************/
+
+void wav_header (struct RIFFfmtdata *head, int channels, int size) {
+
+  int   i;
+  short s;
+
+  memcpy (head->data1,      "RIFF", 4);
+  i = size + 36;
+  memcpy (head->data1 + 4,  &i, 4);
+  memcpy (head->data1 + 8,  "WAVEfmt ", 8);
+  i = 16;                                        // fmt chunk size
+  memcpy (head->data1 + 16, &i, 4);
+  s = 1;                                         // PCM
+  memcpy (head->data1 + 20, &s, 2);
+  head->numchannels = channels;
+  i = 44100;
+  memcpy (head->data2,      &i, 4);
+  i = 44100 * channels * 2;                      // Bytes per second
+  memcpy (head->data2 + 4,  &i, 4);
+  s = channels * 2;                              // Block align
+  memcpy (head->data2 + 8,  &s, 2);
+  s = 16;                                        // Bits per sample
+  memcpy (head->data2 + 10, &s, 2);
+  memcpy (head->data2 + 12, "data", 4);
+  head->size = size;
+}
@@ -0,0 +1,481 @@
+/****************************************************************************
+ * Slampler : Slug Sampler
+ *
+ * Per-bank insert effects: biquad EQ, tempo-synced delay, reverb send
+ *
+ * Each bank with effects is mixed on its own bus, processed a block at a
+ * time, then added to the master bus. The reverb is shared, fed by the
+ * send of each bank.
+ *
+ * Integer only: the Slug's XScale has no FPU, let alone SIMD. Buses are
+ * 32-bit at 16-bit scale, gains are Q15, EQ coefficients Q26. Kernels are
+ * plain loops over contiguous blocks, built with -O2 -ftree-vectorize: on
+ * CPUs with SIMD, gcc vectorizes the delay, the combs and allpasses and
+ * the bus sums. The EQ recursion (both channels side by side) and the
+ * 64-bit reverb send stay scalar.
+ * Scaling divides rather than shifts: rounding towards zero lets the
+ * tails die out instead of settling on a DC offset.
+ *
+ * Copyright (C) Jean Zundel <jzu@free.fr> 2010
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <limits.h>
+#include "slampler.h"
+
+#define NFX      32        /* Effect lines in the config file */
+#define MAXDELAY 4         /* Seconds */
+#define NCOMB    4
+#define NALLP    2
+#define REPORT   10        /* Seconds of audio between CPU reports */
+
+#define Q15(x) ((int) ((x) * 32768.0))
+#define Q26(x) ((int) ((x) * 67108864.0))
+
+struct fxspec {                      // As read by config()
+  char   kind [8];
+  int    bank;
+  char   type [16];
+  double p [3];
+};
+
+struct fxspec spec [NFX];
+int    nspec = 0;
+
+int    fx_on = 0;                    // Any effect at all
+int    fx_tail = 0;                  // Frames of silence before going idle
+int    tempo = 120;                  // BPM, for delays (cfg)
+
+struct fxchain *chain;               // [nbanks]
+
+int   *fxsend;                       // Reverb input, mono
+int   *fxacc;                        // Reverb output, mono
+
+int   comb_len [NCOMB] = { 1116, 1188, 1277, 1356 };    // Freeverb's
+int   allp_len [NALLP] = { 556, 441 };
+int   *comb [NCOMB],
+      *allp [NALLP];
+int   comb_pos [NCOMB],
+      allp_pos [NALLP];
+int   verb_on = 0;
+
+long long verb_ns = 0;               // For the CPU report
+int       report_frames = 0;
+
+
+/****************************************************************************
+ * fx_parse()
+ *
+ * Called by config() for eq, delay and reverb lines
+ *
+ *  eq = BANK peak|lowpass|highpass FREQ [GAIN_DB [Q]]
+ *  delay = BANK BEATS FEEDBACK MIX
+ *  reverb = BANK SEND
+ *
+ * *kind   Keyword
+ * *value  Rest of the line
+ ****************************************************************************/
+
+void fx_parse (char *kind, char *value) {
+
+  struct fxspec *f;
+  int n = 0;
+
+  if (nspec == NFX)
+    return;
+  f = &spec [nspec];
+  memset (f, 0, sizeof (struct fxspec));
+  strncpy (f->kind, kind, 7);
+
+  if (strcmp (kind, "eq") == 0) {
+    f->p [1] = 0.0;
+    f->p [2] = 0.707;
+    n = sscanf (value, "%d %15s %lf %lf %lf",
+                &f->bank, f->type, &f->p [0], &f->p [1], &f->p [2]);
+    n = (n >= 3);
+  }
+  else
+  if (strcmp (kind, "delay") == 0)
+    n = (sscanf (value, "%d %lf %lf %lf",
+                 &f->bank, &f->p [0], &f->p [1], &f->p [2]) == 4);
+  else
+  if (strcmp (kind, "reverb") == 0)
+    n = (sscanf (value, "%d %lf", &f->bank, &f->p [0]) == 2);
+
+  if (n)
+    nspec++;                                     // Else ignored
+}
+
+
+/****************************************************************************
+ * eq_init()
+ *
+ * RBJ cookbook coefficients, computed once
+ * *q  Filter
+ * *f  Spec
+ ****************************************************************************/
+
+void eq_init (struct biquad *q, struct fxspec *f) {
+
+  double w0,
+         cs,
+         alpha,
+         a,
+         b0, b1, b2, a0, a1, a2;
+
+  if ((f->p [0] <= 0) || (f->p [0] >= RATE / 2) || (f->p [2] <= 0))
+    return;
+
+  w0 = 2 * M_PI * f->p [0] / RATE;
+  cs = cos (w0);
+  alpha = sin (w0) / (2 * f->p [2]);
+
+  if (strcmp (f->type, "lowpass") == 0) {
+    b0 = b2 = (1 - cs) / 2;
+    b1 = 1 - cs;
+    a0 = 1 + alpha;
+    a1 = -2 * cs;
+    a2 = 1 - alpha;
+  }
+  else
+  if (strcmp (f->type, "highpass") == 0) {
+    b0 = b2 = (1 + cs) / 2;
+    b1 = -(1 + cs);
+    a0 = 1 + alpha;
+    a1 = -2 * cs;
+    a2 = 1 - alpha;
+  }
+  else {                                         // Peak
+    if (f->p [1] > 24)
+      f->p [1] = 24;                             // Keeps b0 within Q26
+    a = pow (10, f->p [1] / 40);
+    b0 = 1 + alpha * a;
+    b1 = -2 * cs;
+    b2 = 1 - alpha * a;
+    a0 = 1 + alpha / a;
+    a1 = -2 * cs;
+    a2 = 1 - alpha / a;
+  }
+
+  memset (q, 0, sizeof (struct biquad));
+  q->b0 = Q26 (b0 / a0);
+  q->b1 = Q26 (b1 / a0);
+  q->b2 = Q26 (b2 / a0);
+  q->a1 = Q26 (a1 / a0);
+  q->a2 = Q26 (a2 / a0);
+  q->on = 1;
+}
+
+
+/****************************************************************************
+ * fx_init()
+ *
+ * Builds the chains from the config file, allocating all buffers now
+ * Returns 1 if there is anything to do
+ ****************************************************************************/
+
+int fx_init () {
+
+  struct fxchain *c;
+  struct fxspec  *f;
+  int i,
+      ring;
+
+  chain = (struct fxchain *) calloc (nbanks, sizeof (struct fxchain));
+
+  for (i = 0; i < nspec; i++) {
+    f = &spec [i];
+    if ((f->bank < 0) || (f->bank >= nbanks))
+      continue;
+    c = &chain [f->bank];
+
+    if (strcmp (f->kind, "eq") == 0) {
+      eq_init (&c->eq, f);
+      if (c->eq.on) {                 // -96 dB: 11 time constants, Q / pi f
+        ring = 11.1 * f->p [2] / (M_PI * f->p [0]) * RATE + frames;
+        if (ring > fx_tail)
+          fx_tail = ring;
+      }
+    }
+    else
+    if ((strcmp (f->kind, "delay") == 0) && (tempo > 0) && (f->p [0] > 0)) {
+      c->dl.len = f->p [0] * 60 * RATE / tempo;
+      if (c->dl.len > MAXDELAY * RATE)
+        c->dl.len = MAXDELAY * RATE;
+      if (c->dl.len < 1)
+        c->dl.len = 1;
+      free (c->dl.line);
+      c->dl.line = (short *) calloc (c->dl.len * 2, sizeof (short));
+      c->dl.pos = 0;
+      c->dl.fb  = Q15 (f->p [1] < 0.99 ? f->p [1] : 0.99);
+      c->dl.mix = Q15 (f->p [2] < 0.99 ? f->p [2] : 0.99);
+    }
+    else
+    if ((strcmp (f->kind, "reverb") == 0) && (f->p [0] > 0)) {
+      c->send = Q15 (f->p [0] < 0.99 ? f->p [0] : 0.99);
+      verb_on = 1;
+    }
+  }
+
+  for (i = 0; i < nbanks; i++) {
+    if (chain [i].dl.len > fx_tail)
+      fx_tail = chain [i].dl.len;               // Longest line, at least
+    chain [i].on = chain [i].eq.on || chain [i].dl.line || chain [i].send;
+    fx_on |= chain [i].on;
+    if (chain [i].on)
+      DEBUG ("fx %d:%s%s%s\n", i,
+             chain [i].eq.on  ? " eq"     : "",
+             chain [i].dl.line ? " delay"  : "",
+             chain [i].send    ? " reverb" : "");
+  }
+
+  if (verb_on) {
+    fxsend = (int *) calloc (frames, sizeof (int));
+    fxacc  = (int *) calloc (frames, sizeof (int));
+    fx_tail += comb_len [NCOMB-1] + allp_len [0] + allp_len [1];
+    for (i = 0; i < NCOMB; i++) {
+      comb [i] = (int *) calloc (comb_len [i], sizeof (int));
+      comb_pos [i] = 0;
+    }
+    for (i = 0; i < NALLP; i++) {
+      allp [i] = (int *) calloc (allp_len [i], sizeof (int));
+      allp_pos [i] = 0;
+    }
+  }
+
+  return fx_on;
+}
+
+
+/****************************************************************************
+ * biquad()
+ *
+ * In place, both channels in the same pass
+ * *q    Filter
+ * *bus  Interleaved stereo
+ * n     Number of frames
+ ****************************************************************************/
+
+void biquad (struct biquad *q, int *bus, int n) {
+
+  long long yl,
+            yr;
+  int xl,
+      xr,
+      i;
+
+  for (i = 0; i < n*2; i += 2) {
+    xl = bus [i];
+    xr = bus [i+1];
+    yl = (long long) q->b0 * xl
+       + (long long) q->b1 * q->x1 [0]
+       + (long long) q->b2 * q->x2 [0]
+       - (long long) q->a1 * q->y1 [0]
+       - (long long) q->a2 * q->y2 [0];
+    yr = (long long) q->b0 * xr
+       + (long long) q->b1 * q->x1 [1]
+       + (long long) q->b2 * q->x2 [1]
+       - (long long) q->a1 * q->y1 [1]
+       - (long long) q->a2 * q->y2 [1];
+    q->x2 [0] = q->x1 [0];
+    q->x2 [1] = q->x1 [1];
+    q->x1 [0] = xl;
+    q->x1 [1] = xr;
+    q->y2 [0] = q->y1 [0];
+    q->y2 [1] = q->y1 [1];
+    q->y1 [0] = bus [i]   = yl / (1 << 26);
+    q->y1 [1] = bus [i+1] = yr / (1 << 26);
+  }
+}
+
+
+/****************************************************************************
+ * delay()
+ *
+ * In place, feedback delay line, stereo
+ * Walks the line in contiguous segments, no wrap inside the inner loop
+ * *d    Delay
+ * *bus  Interleaved stereo
+ * n     Number of frames
+ ****************************************************************************/
+
+void delay (struct delay *d, int *bus, int n) {
+
+  short *line;
+  int seg,
+      x,
+      y,
+      i;
+
+  while (n > 0) {
+    seg = d->len - d->pos;
+    if (seg > n)
+      seg = n;
+    line = d->line + d->pos * 2;
+    for (i = 0; i < seg*2; i++) {
+      x = bus [i];
+      y = line [i];
+      bus [i] = x + (y * d->mix) / 32768;
+      x += (y * d->fb) / 32768;
+      line [i] = (x > SHRT_MAX) ? SHRT_MAX :
+                 (x < SHRT_MIN) ? SHRT_MIN : x;
+    }
+    bus += seg * 2;
+    n -= seg;
+    d->pos += seg;
+    if (d->pos == d->len)
+      d->pos = 0;
+  }
+}
+
+
+/****************************************************************************
+ * reverb()
+ *
+ * Schroeder reverb, four combs into two allpasses, mono in, added to
+ * both channels of the master bus
+ * *send    Mono input, overwritten
+ * *master  Interleaved stereo
+ * n        Number of frames, up to frames
+ ****************************************************************************/
+
+void reverb (int *send, int *master, int n) {
+
+  int *line,
+      *acc = fxacc;
+  int c,
+      seg,
+      done,
+      y,
+      i;
+
+  for (i = 0; i < n; i++)
+    send [i] /= 8;                               // Comb gain is ~6
+  memset (acc, 0, n * sizeof (int));
+
+  for (c = 0; c < NCOMB; c++)                    // Feedback 27/32
+    for (done = 0; done < n; done += seg) {
+      seg = comb_len [c] - comb_pos [c];
+      if (seg > n - done)
+        seg = n - done;
+      line = comb [c] + comb_pos [c];
+      for (i = 0; i < seg; i++) {
+        y = line [i];
+        acc [done + i] += y;
+        line [i] = send [done + i] + (y * 27) / 32;
+      }
+      comb_pos [c] = (comb_pos [c] + seg) % comb_len [c];
+    }
+
+  for (c = 0; c < NALLP; c++)                    // g = 0.5
+    for (done = 0; done < n; done += seg) {
+      seg = allp_len [c] - allp_pos [c];
+      if (seg > n - done)
+        seg = n - done;
+      line = allp [c] + allp_pos [c];
+      for (i = 0; i < seg; i++) {
+        y = line [i];
+        line [i] = acc [done + i] + y / 2;
+        acc [done + i] = y - acc [done + i];
+      }
+      allp_pos [c] = (allp_pos [c] + seg) % allp_len [c];
+    }
+
+  for (i = 0; i < n; i++) {
+    master [i*2]   += acc [i] / 4;
+    master [i*2+1] += acc [i] / 4;
+  }
+}
+
+
+/****************************************************************************
+ * fx_bank()
+ *
+ * Runs the chain of a bank on its bus, adds the result to the master bus
+ * and the reverb send
+ * b        Bank
+ * *bus     Interleaved stereo, clobbered
+ * *master  Interleaved stereo
+ * n        Number of frames
+ ****************************************************************************/
+
+void fx_bank (int b, int *bus, int *master, int n) {
+
+  struct fxchain *c = &chain [b];
+  long long t = 0;
+  int i;
+
+  if (c->on) {
+    if (debug)
+      t = clock_ns (CLOCK_THREAD_CPUTIME_ID);
+    if (c->eq.on)
+      biquad (&c->eq, bus, n);
+    if (c->dl.line)
+      delay (&c->dl, bus, n);
+    if (c->send)
+      for (i = 0; i < n; i++)
+        fxsend [i] += ((long long) (bus [i*2] + bus [i*2+1]) * c->send) / 65536;
+    if (debug)
+      c->ns += clock_ns (CLOCK_THREAD_CPUTIME_ID) - t;
+  }
+
+  for (i = 0; i < n*2; i++)
+    master [i] += bus [i];
+}
+
+
+/****************************************************************************
+ * fx_master()
+ *
+ * Once all banks are in: reverb, CPU report in debug mode
+ * *master  Interleaved stereo
+ * n        Number of frames
+ ****************************************************************************/
+
+void fx_master (int *master, int n) {
+
+  long long t = 0;
+  double audio;
+  int b;
+
+  if (verb_on) {
+    if (debug)
+      t = clock_ns (CLOCK_THREAD_CPUTIME_ID);
+    reverb (fxsend, master, n);
+    memset (fxsend, 0, frames * sizeof (int));
+    if (debug)
+      verb_ns += clock_ns (CLOCK_THREAD_CPUTIME_ID) - t;
+  }
+
+  if (! debug)
+    return;
+  report_frames += n;
+  if (report_frames < REPORT * RATE)
+    return;
+
+  audio = report_frames * 1e9 / RATE;            // ns of sound produced
+  for (b = 0; b < nbanks; b++)
+    if (chain [b].on) {
+      DEBUG ("fx %d: %5.2f%% CPU\n", b, chain [b].ns * 100.0 / audio);
+      chain [b].ns = 0;
+    }
+  if (verb_on)
+    DEBUG ("reverb: %5.2f%% CPU\n", verb_ns * 100.0 / audio);
+  verb_ns = 0;
+  report_frames = 0;
+}
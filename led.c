@@ -0,0 +1,62 @@
+/****************************************************************************
+ * Slampler : Slug Sampler
+ *
+ * NSLU2 LEDs
+ *
+ * Copyright (C) Jean Zundel <jzu@free.fr> 2010 
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ ****************************************************************************/
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "slampler.h"
+
+
+/**************************************************************************** 
+ * write_to_file()
+ *
+ * Write a string to a file 
+ * Fails silently (in case of insufficient rights)
+ * *f  Filename
+ * *s  String to write
+ ****************************************************************************/
+
+void write_to_file (const char *f, const char *s) {
+
+  int fout;
+
+  if ((fout = open (f, O_WRONLY)) > 0) {
+    write (fout, s, strlen (s));
+    close (fout);
+  }
+}
+
+
+/****************************************************************************
+ * set_led()
+ *
+ * Switch LEDs on/off 
+ * Needs to be run as root to work, else nothing happens
+ * *led  Dirname (/sys/classes/leds/foo/)
+ * i     Value   (0||!0)
+ ****************************************************************************/
+
+void set_led (char *led, int i) {
+
+  char led_bright [256];
+
+  strncpy (led_bright, led, 255);
+  strncat (led_bright, "/brightness", 255);
+  write_to_file (led_bright, i ? "255" : "0");
+}   
@@ -0,0 +1,165 @@
+/****************************************************************************
+ * Slampler : Slug Sampler
+ *
+ * Definitions shared by the player, its mix engine and audio backends
+ *
+ * Copyright (C) Jean Zundel <jzu@free.fr> 2010
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ ****************************************************************************/
+
+#ifndef SLAMPLER_H
+#define SLAMPLER_H
+
+#include <stdio.h>
+#include <time.h>
+
+#define FRAMES 44          /* Don't ask */
+#define RATE   44100
+
+#define NTAKES 4           /* Preallocated capture slots */
+
+#define DATADIR "/data"
+
+#define DEBUG if (debug) printf
+#define ERROR if (debug) fprintf
+
+// LEDs
+
+#define LED_DISK1  "/sys/class/leds/nslu2:green:disk-1"
+#define LED_DISK2  "/sys/class/leds/nslu2:green:disk-2"
+#define LED_READY  "/sys/class/leds/nslu2:green:ready"
+#define LED_STATUS "/sys/class/leds/nslu2:red:status"
+
+// WAV handling
+
+struct RIFFfmtdata {
+  char  data1 [22];
+  short numchannels;                 // 1 or 2
+  char  data2 [16];
+  int   size;                        // of data to play back
+};
+
+struct wcb {                         // Wave Control Block
+  char   path [256];                 //  filename
+  int    fd;                         //  file descriptor
+  int    start;                      //  switch activated
+  struct RIFFfmtdata head;           //  WAV header
+  short  *ram;                       //  take or preloaded file (stereo)
+  int    ramlen;                     //  its length in frames
+  short  *file;                      //  preloaded file (stereo), or NULL
+  int    filelen;                    //  its length in frames
+  int    pos;                        //  ram read position in frames
+  int    live;                       //  playing from ram
+};
+
+// Audio backends
+// Each one owns its buffers and its clock, and calls render() (and
+// capture(), when capture is on) with as many frames as it wants.
+
+struct backend {
+  char *name;
+  int  (*open) (char *device, int capt);   // < 0 on failure
+  void (*run) ();                          // Never returns
+};
+
+extern struct backend alsa_backend;
+extern struct backend mmap_backend;
+extern struct backend jack_backend;
+extern struct backend null_backend;
+
+// Engine (engine.c)
+
+extern struct wcb **wave;            // [nbanks][nsmpls]
+extern int  *smpl_flag;              // Which sample to start now
+extern int  rec_flag;                // Record switch activated
+extern int  nsmpls;                  // Number of samples per bank (cfg)
+extern int  nbanks;                  // Number of banks (cfg)
+extern int  capt_secs;               // Capture slot length, 0 = off (cfg)
+extern int  capt_in;                 // The backend feeds capture()
+extern char dumpdir [256];           // Where to save takes, "" = don't (cfg)
+extern char datadir [128];           // Where the banks are
+extern int  bank;                    // Current bank
+extern int  frames;                  // Mixing granularity
+extern int  debug;
+extern int  rt;                      // Called from a real-time callback
+extern volatile int led_status;      // Status LED, set by the backend if rt
+
+void  engine_init ();
+long long clock_ns (clockid_t clk);
+int   engine_idle ();
+int   engine_wait (int ms);
+void  wake ();
+void  load_waves (int rep);
+int   preload_waves ();
+void  render (short *out, int n);
+void  triggers ();
+void  mix (short *playbuf, int n);
+void  upmix (short *buf, int n);
+void  mixclip (short *playbuf, short *filebuf, int n);
+void  mixbus (int *bus, short *filebuf, int n);
+void  clip (short *playbuf, int *master, int n);
+void  capture (short *in, int n);
+void  *dumper ();
+void  wav_header (struct RIFFfmtdata *head, int channels, int size);
+
+// Effects (fx.c)
+
+struct biquad {                      // EQ, Direct Form I
+  int on;
+  int b0, b1, b2, a1, a2;            //  Q26
+  int x1 [2], x2 [2],                //  L, R history
+      y1 [2], y2 [2];
+};
+
+struct delay {                       // Tempo-synced, stereo
+  short *line;                       //  NULL if none
+  int   len,                         //  in frames
+        pos;
+  int   fb,                          //  Q15
+        mix;                         //  Q15
+};
+
+struct fxchain {                     // One per bank
+  int    on;
+  struct biquad eq;
+  struct delay  dl;
+  int    send;                       //  to the reverb, Q15
+  long long ns;                      //  CPU time, for -d
+};
+
+extern int fx_on;                    // Any effect at all
+extern int fx_tail;                  // Frames of silence before going idle
+extern int tempo;                    // BPM, for delays (cfg)
+extern struct fxchain *chain;        // [nbanks]
+extern int *fxsend;                  // Reverb input, mono
+
+void  fx_parse (char *kind, char *value);
+int   fx_init ();
+void  fx_bank (int b, int *bus, int *master, int n);
+void  fx_master (int *master, int n);
+void  biquad (struct biquad *q, int *bus, int n);
+void  delay (struct delay *d, int *bus, int n);
+void  reverb (int *send, int *master, int n);
+
+// Configuration (config.c)
+
+extern char device [256];            // Audio device we're using (cfg)
+extern char output [256];            // Audio backend (cfg)
+
+void  config (char *path);
+
+// LEDs (led.c)
+
+void  set_led (char *led, int i);
+
+#endif